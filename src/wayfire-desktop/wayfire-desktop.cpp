@@ -24,6 +24,10 @@
 
 
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cmath>
+#include <algorithm>
 #include <wayfire/core.hpp>
 #include <wayfire/view.hpp>
 #include <wayfire/plugin.hpp>
@@ -62,6 +66,13 @@ printf("sending view data: %s\n", actions);fflush(stdout);
     }
 }
 
+static std::string sanitize_field(std::string str)
+{
+    std::replace_if(str.begin(), str.end(),
+        [] (char c) { return c == '\t' || c == '\n'; }, ' ');
+    return str;
+}
+
 std::string wayfire_desktop::get_actions_for_view()
 {
     auto view = origin_view;
@@ -71,7 +82,8 @@ std::string wayfire_desktop::get_actions_for_view()
     {
         return "";
     }
-    actions += "Title:" + view->get_title();
+    actions += "Title:" + sanitize_field(view->get_title());
+    actions += "\nAppId:" + sanitize_field(view->get_app_id());
     actions += "\nMaximized:";
     if (view->tiled_edges == wf::TILED_EDGES_ALL)
     {
@@ -92,10 +104,156 @@ std::string wayfire_desktop::get_actions_for_view()
     return actions;
 }
 
+/* Workspace the center of the view is on, clamped to the grid */
+static wf::point_t get_view_workspace(wayfire_view view)
+{
+    auto output = view->get_output();
+    auto og     = output->get_relative_geometry();
+    auto vg     = view->get_wm_geometry();
+    auto cws    = output->workspace->get_current_workspace();
+    auto grid   = output->workspace->get_workspace_grid_size();
+
+    int x = cws.x + (int)std::floor(
+        (vg.x + vg.width / 2.0) / std::max(og.width, 1));
+    int y = cws.y + (int)std::floor(
+        (vg.y + vg.height / 2.0) / std::max(og.height, 1));
+
+    return {std::clamp(x, 0, grid.width - 1), std::clamp(y, 0, grid.height - 1)};
+}
+
+
+std::string wayfire_desktop::get_view_list()
+{
+    struct view_entry
+    {
+        size_t output_index;
+        wf::point_t ws;
+        wayfire_view view;
+    };
+
+    auto outputs = wf::get_core().output_layout->get_outputs();
+    std::vector<view_entry> entries;
+
+    for (auto& view : wf::get_core().get_all_views())
+    {
+        if (!view->is_mapped() || (view->role != wf::VIEW_ROLE_TOPLEVEL) ||
+            (view == menu_view) || (view->get_app_id() == std::string(app_id)))
+        {
+            continue;
+        }
+
+        auto it = std::find(outputs.begin(), outputs.end(), view->get_output());
+        if (it == outputs.end())
+        {
+            continue;
+        }
+
+        entries.push_back({(size_t)(it - outputs.begin()),
+            get_view_workspace(view), view});
+    }
+
+    /* Group by output, then by workspace in row-major order */
+    std::stable_sort(entries.begin(), entries.end(),
+        [] (const view_entry& a, const view_entry& b)
+    {
+        return std::tie(a.output_index, a.ws.y, a.ws.x) <
+               std::tie(b.output_index, b.ws.y, b.ws.x);
+    });
+
+    std::string list;
+    for (auto& e : entries)
+    {
+        list += std::to_string(e.view->get_id()) + "\t" +
+            std::to_string(e.ws.x) + "\t" + std::to_string(e.ws.y) + "\t" +
+            sanitize_field(outputs[e.output_index]->to_string()) + "\t" +
+            sanitize_field(e.view->get_app_id()) + "\t" +
+            sanitize_field(e.view->get_title()) + "\n";
+    }
+
+    return list;
+}
+
+void wayfire_desktop::send_view_list(wl_resource *resource)
+{
+    auto list = get_view_list();
+
+    /* The list easily exceeds the wayland message size limit with a few
+     * hundred windows, so it is passed as a memfd in a single event */
+    int fd = memfd_create("wf-desktop-view-list", MFD_CLOEXEC);
+    if (fd < 0)
+    {
+        LOGE("Failed to create view list memfd");
+        return;
+    }
+
+    size_t written = 0;
+    while (written < list.size())
+    {
+        auto ret = write(fd, list.data() + written, list.size() - written);
+        if (ret <= 0)
+        {
+            LOGE("Failed to write view list");
+            close(fd);
+            return;
+        }
+
+        written += ret;
+    }
+
+    wf_desktop_base_send_view_list(resource, fd, list.size());
+    close(fd);
+}
+
+std::string wayfire_desktop::get_layout()
+{
+    std::string layout;
+
+    if (origin_view && origin_view->get_output())
+    {
+        auto ws = get_view_workspace(origin_view);
+        layout += "View:" + std::to_string(ws.x) + "," + std::to_string(ws.y) +
+            ":" + origin_view->get_output()->to_string() + "\n";
+    }
+
+    for (auto& output : wf::get_core().output_layout->get_outputs())
+    {
+        auto grid = output->workspace->get_workspace_grid_size();
+        layout += "Output:" + std::to_string(grid.width) + "," +
+            std::to_string(grid.height) + ":" + output->to_string() + "\n";
+    }
+
+    return layout;
+}
+
+void wayfire_desktop::send_layout(wl_resource *resource)
+{
+    if (wl_resource_get_version(resource) >= WF_DESKTOP_BASE_LAYOUT_SINCE_VERSION)
+    {
+        wf_desktop_base_send_layout(resource, get_layout().c_str());
+    }
+}
+
+/* The shell execs a plain command in place, so the menu client has the
+ * pid core returned when spawning it */
+bool wayfire_desktop::is_menu_client(wl_client *client)
+{
+    pid_t pid;
+
+    if (!client || (menu_pid <= 0))
+    {
+        return false;
+    }
+
+    wl_client_get_credentials(client, &pid, nullptr, nullptr);
+
+    return pid == menu_pid;
+}
+
 wayfire_desktop::wayfire_desktop()
 {
     manager = wl_global_create(wf::get_core().display,
-        &wf_desktop_base_interface, 1, this, bind_manager);
+        &wf_desktop_base_interface, wf_desktop_base_interface.version,
+        this, bind_manager);
 
     if (!manager)
     {
@@ -106,7 +264,8 @@ wayfire_desktop::wayfire_desktop()
     view_mapped.set_callback([this] (wf::signal_data_t *data)
     {
         auto view = get_signaled_view(data);
-        if (!view || !origin_view || (view->get_app_id() != std::string(app_id)))
+        if (!view || !origin_view || (view->get_app_id() != std::string(app_id)) ||
+            !is_menu_client(view->get_client()))
         {
             return;
         }
@@ -198,6 +357,7 @@ wayfire_desktop::wayfire_desktop()
         if (view && (menu_view == view))
         {
             menu_view = origin_view = nullptr;
+            menu_pid  = 0;
             wf::get_core().disconnect_signal(&on_button);
             auto output = view->get_output();
             if (!output)
@@ -216,19 +376,62 @@ wayfire_desktop::wayfire_desktop()
         }
 
         /* Showing menu for this view */
-        origin_view = get_signaled_view(data);
-        auto output = origin_view->get_output();
+        auto view   = get_signaled_view(data);
+        auto output = view ? view->get_output() : nullptr;
         if (!output)
         {
             return;
         }
+        origin_view = view;
         output->connect_signal("view-mapped", &view_mapped);
         position_offset =
             ((wf::view_show_window_menu_signal*)data)->relative_position;
-        wf::get_core().run(std::string(command));
+        menu_pid = wf::get_core().run(std::string(command));
     });
 
     wf::get_core().connect_signal("view-show-window-menu", &show_window_menu);
+
+    /* Keep the layout of bound clients current across hotplug */
+    output_added.set_callback([this] (wf::signal_data_t *data)
+    {
+        auto output = get_signaled_output(data);
+        auto grid   = output->workspace->get_workspace_grid_size();
+        for (auto r : client_resources)
+        {
+            if (wl_resource_get_version(r) >= WF_DESKTOP_BASE_OUTPUT_ADDED_SINCE_VERSION)
+            {
+                wf_desktop_base_send_output_added(r, output->to_string().c_str(),
+                    grid.width, grid.height);
+            }
+        }
+    });
+
+    output_removed.set_callback([this] (wf::signal_data_t *data)
+    {
+        auto output = get_signaled_output(data);
+        for (auto r : client_resources)
+        {
+            if (wl_resource_get_version(r) >= WF_DESKTOP_BASE_OUTPUT_REMOVED_SINCE_VERSION)
+            {
+                wf_desktop_base_send_output_removed(r, output->to_string().c_str());
+            }
+        }
+
+        /* The views of the removed output have been moved by now */
+        auto view = origin_view;
+        if (menu_resource && view && view->get_output() &&
+            (view->get_output() != output) &&
+            (wl_resource_get_version(menu_resource) >=
+             WF_DESKTOP_BASE_VIEW_WORKSPACE_SINCE_VERSION))
+        {
+            auto ws = get_view_workspace(view);
+            wf_desktop_base_send_view_workspace(menu_resource,
+                view->get_output()->to_string().c_str(), ws.x, ws.y);
+        }
+    });
+
+    wf::get_core().output_layout->connect_signal("output-added", &output_added);
+    wf::get_core().output_layout->connect_signal("output-removed", &output_removed);
 }
 
 wayfire_desktop::~wayfire_desktop()
@@ -277,19 +480,149 @@ static void handle_close(struct wl_client *client, struct wl_resource *resource)
     }
 }
 
+static void handle_move_to_workspace(struct wl_client *client,
+    struct wl_resource *resource, int32_t x, int32_t y)
+{
+    LOGI(__func__);
+    wayfire_desktop *wd = (wayfire_desktop*)wl_resource_get_user_data(resource);
+    auto view = wd->origin_view;
+
+    if (!view || !view->get_output())
+    {
+        return;
+    }
+
+    while (view->parent)
+    {
+        view = view->parent;
+    }
+
+    auto output = view->get_output();
+    auto grid   = output->workspace->get_workspace_grid_size();
+    wf::point_t to{x, y};
+    if ((x < 0) || (y < 0) || (x >= grid.width) || (y >= grid.height))
+    {
+        return;
+    }
+
+    auto from = get_view_workspace(view);
+    if (from == to)
+    {
+        return;
+    }
+
+    /* Shift the view and its dialogs by whole workspaces, keeping their
+     * relative positions, then let other plugins know like vswitch does */
+    auto og = output->get_relative_geometry();
+    for (auto& v : view->enumerate_views(false))
+    {
+        auto vg = v->get_wm_geometry();
+        v->move(vg.x + (to.x - from.x) * og.width,
+            vg.y + (to.y - from.y) * og.height);
+    }
+
+    wf::view_change_workspace_signal data;
+    data.view = view;
+    data.from = from;
+    data.to   = to;
+    output->emit_signal("view-change-workspace", &data);
+}
+
+static void handle_move_to_output(struct wl_client *client,
+    struct wl_resource *resource, const char *name)
+{
+    LOGI(__func__);
+    wayfire_desktop *wd = (wayfire_desktop*)wl_resource_get_user_data(resource);
+    auto view = wd->origin_view;
+
+    if (!view)
+    {
+        return;
+    }
+
+    /* Move the toplevel along with its dialogs, as move_to_workspace does */
+    while (view->parent)
+    {
+        view = view->parent;
+    }
+
+    for (auto& output : wf::get_core().output_layout->get_outputs())
+    {
+        if ((output->to_string() == name) && (output != view->get_output()))
+        {
+            wf::get_core().move_view_to_output(view, output, true);
+            return;
+        }
+    }
+}
+
+static void handle_list_views(struct wl_client *client, struct wl_resource *resource)
+{
+    LOGI(__func__);
+    wayfire_desktop *wd = (wayfire_desktop*)wl_resource_get_user_data(resource);
+
+    wd->send_view_list(resource);
+}
+
+static void handle_activate_view(struct wl_client *client,
+    struct wl_resource *resource, uint32_t view_id)
+{
+    LOGI(__func__);
+    for (auto& view : wf::get_core().get_all_views())
+    {
+        if (view->get_id() != view_id)
+        {
+            continue;
+        }
+
+        auto output = view->get_output();
+        if (!view->is_mapped() || !output)
+        {
+            return;
+        }
+
+        if (view->minimized)
+        {
+            view->minimize_request(false);
+        }
+
+        wf::get_core().focus_output(output);
+        output->ensure_visible(view);
+        output->focus_view(view, true);
+        return;
+    }
+}
+
 static const struct wf_desktop_base_interface wayfire_desktop_impl =
 {
     .maximize = handle_maximize,
     .minimize = handle_minimize,
     .close    = handle_close,
+    .list_views    = handle_list_views,
+    .activate_view = handle_activate_view,
+    .move_to_workspace = handle_move_to_workspace,
+    .move_to_output    = handle_move_to_output,
 };
 
 static void destroy_client(wl_resource *resource)
 {
     wayfire_desktop *wd = (wayfire_desktop*)wl_resource_get_user_data(resource);
 
-    auto vector = wd->client_resources;
-    std::remove(vector.begin(), vector.end(), resource);
+    auto& vector = wd->client_resources;
+    vector.erase(std::remove(vector.begin(), vector.end(), resource),
+        vector.end());
+
+    if (resource == wd->menu_resource)
+    {
+        wd->menu_resource = nullptr;
+
+        /* The menu went away without ever mapping, release the view */
+        if (!wd->menu_view)
+        {
+            wd->origin_view = nullptr;
+            wd->menu_pid    = 0;
+        }
+    }
 }
 
 static void bind_manager(wl_client *client, void *data,
@@ -297,20 +630,22 @@ static void bind_manager(wl_client *client, void *data,
 {
     wayfire_desktop *wd = (wayfire_desktop*)data;
 
-    if (!wd->origin_view)
-    {
-        wd->origin_view = wf::get_core().get_cursor_focus_view();
-    }
-    if (!wd->origin_view)
-    {
-        return;
-    }
+    /* Only the client spawned by show_window_menu is about origin_view.
+     * Others, such as the switcher, must not see or hold on to it, or
+     * titlebar menus would stop working while they are open. */
+    bool is_menu = wd->origin_view && !wd->menu_resource &&
+        wd->is_menu_client(client);
 
-    auto resource =
-        wl_resource_create(client, &wf_desktop_base_interface, 1, id);
+    auto resource = wl_resource_create(client, &wf_desktop_base_interface,
+        std::min(version, (uint32_t)wf_desktop_base_interface.version), id);
     wl_resource_set_implementation(resource,
         &wayfire_desktop_impl, data, destroy_client);
     wd->client_resources.push_back(resource);
-    wd->send_view_data(resource);
+    if (is_menu)
+    {
+        wd->menu_resource = resource;
+        wd->send_view_data(resource);
+        wd->send_layout(resource);
+    }
     
 }
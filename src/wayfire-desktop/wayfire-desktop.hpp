@@ -34,15 +34,25 @@ class wayfire_desktop
     wf::signal_connection_t view_unmapped;
     wf::signal_connection_t view_mapped;
     wf::signal_connection_t on_button;
-    wayfire_view menu_view   = nullptr;
+    wf::signal_connection_t output_added;
+    wf::signal_connection_t output_removed;
     std::string get_actions_for_view();
+    std::string get_view_list();
+    std::string get_layout();
     wf::point_t position_offset;
     wl_global *manager;
 
   public:
     wayfire_view origin_view = nullptr;
+    wayfire_view menu_view   = nullptr;
+    /* Pid of the spawned menu command, 0 when no menu is up */
+    pid_t menu_pid = 0;
+    bool is_menu_client(wl_client *client);
+    wl_resource *menu_resource = nullptr;
     std::vector<wl_resource*> client_resources;
     void send_view_data(wl_resource *resource);
+    void send_view_list(wl_resource *resource);
+    void send_layout(wl_resource *resource);
     wayfire_desktop();
     ~wayfire_desktop();
 };
@@ -0,0 +1,792 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Scott Moreau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <map>
+#include <set>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "app-index.hpp"
+
+#define INDEX_MAGIC "WFAI"
+#define INDEX_VERSION 2
+#define ICON_SIZE 48
+#define ICON_THEME_DEPTH 3
+#define HIDDEN_ENTRY ((size_t)-1)
+
+namespace
+{
+/* On disk layout: header, dirs, buckets, entries, strings. String fields
+ * are offsets into the strings section, which starts with an empty string
+ * so that 0 means unset. Buckets hold entry index + 1, 0 being empty. */
+struct index_header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t key;
+    uint32_t n_dirs, dirs;
+    uint32_t n_buckets, buckets;
+    uint32_t n_entries, entries;
+    uint32_t strings, strings_size;
+    uint32_t pad;
+};
+
+struct index_dir
+{
+    uint32_t path;
+    uint32_t pad;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+};
+
+struct index_entry
+{
+    uint32_t key;
+    uint32_t hash;
+    uint32_t name;
+    uint32_t icon;
+};
+
+struct desktop_entry
+{
+    std::string name, icon;
+};
+
+struct icon_match
+{
+    std::string path;
+    int score;
+};
+
+uint32_t hash_key(const std::string& key)
+{
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : key)
+    {
+        hash = (hash ^ c) * 16777619u;
+    }
+
+    return hash;
+}
+
+std::string lowercase(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(),
+        [] (unsigned char c) { return std::tolower(c); });
+    return str;
+}
+
+std::string trim(const std::string& str)
+{
+    auto start = str.find_first_not_of(" \t");
+    if (start == std::string::npos)
+    {
+        return "";
+    }
+
+    return str.substr(start, str.find_last_not_of(" \t") - start + 1);
+}
+
+std::string get_home_dir(const std::string& dir)
+{
+    auto home = getenv("HOME");
+    return std::string(home ? home : "") + "/" + dir;
+}
+
+std::string get_env_dir(const char *var, const std::string& fallback)
+{
+    auto value = getenv(var);
+    if (value && *value)
+    {
+        return value;
+    }
+
+    return get_home_dir(fallback);
+}
+
+std::vector<std::string> get_data_dirs()
+{
+    std::vector<std::string> dirs = {get_env_dir("XDG_DATA_HOME", ".local/share")};
+
+    auto value = getenv("XDG_DATA_DIRS");
+    std::string list = (value && *value) ? value : "/usr/local/share:/usr/share";
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        auto end = list.find(':', start);
+        if (end == std::string::npos)
+        {
+            end = list.size();
+        }
+
+        if (end > start)
+        {
+            dirs.push_back(list.substr(start, end - start));
+        }
+
+        start = end + 1;
+    }
+
+    return dirs;
+}
+
+bool is_dir(const std::string& path, struct dirent *ent)
+{
+    if (ent->d_type != DT_UNKNOWN)
+    {
+        return ent->d_type == DT_DIR;
+    }
+
+    struct stat st;
+    return !stat(path.c_str(), &st) && S_ISDIR(st.st_mode);
+}
+
+/* Lower is better: scalable first, then the size closest to ICON_SIZE */
+int score_icon_dir(const std::string& rel_dir)
+{
+    if (rel_dir.find("scalable") != std::string::npos)
+    {
+        return 0;
+    }
+
+    auto pos = rel_dir.find_first_of("0123456789");
+    if (pos == std::string::npos)
+    {
+        return 1000;
+    }
+
+    return 1 + std::abs(atoi(rel_dir.c_str() + pos) - ICON_SIZE);
+}
+
+class index_builder
+{
+    std::vector<std::pair<std::string, struct stat>> dirs;
+    std::vector<desktop_entry> apps;
+    std::map<std::string, size_t> keys;
+    std::map<std::string, std::string> icons;
+    std::string strings;
+    std::map<std::string, uint32_t> string_offsets;
+
+    /* Missing directories are recorded too, with a zero mtime, so that
+     * creating one later invalidates the index */
+    DIR *open_dir(const std::string& path)
+    {
+        struct stat st = {};
+        DIR *dir = opendir(path.c_str());
+        if (!dir || fstat(dirfd(dir), &st))
+        {
+            st = {};
+        }
+
+        dirs.push_back({path, st});
+        return dir;
+    }
+
+    void parse_desktop_file(const std::string& path, const std::string& id)
+    {
+        std::ifstream file(path);
+        std::string line, name, icon, wm_class;
+        bool in_group = false, hidden = false;
+
+        while (std::getline(file, line))
+        {
+            if (line.empty() || (line[0] == '#'))
+            {
+                continue;
+            }
+
+            if (line[0] == '[')
+            {
+                in_group = (line == "[Desktop Entry]");
+                continue;
+            }
+
+            if (!in_group)
+            {
+                continue;
+            }
+
+            auto eq = line.find('=');
+            if (eq == std::string::npos)
+            {
+                continue;
+            }
+
+            auto key   = trim(line.substr(0, eq));
+            auto value = trim(line.substr(eq + 1));
+            if (key == "Name")
+            {
+                name = value;
+            } else if (key == "Icon")
+            {
+                icon = value;
+            } else if (key == "StartupWMClass")
+            {
+                wm_class = value;
+            } else if ((key == "Hidden") && (value == "true"))
+            {
+                hidden = true;
+            }
+        }
+
+        /* Earlier data dirs take precedence, so a hidden entry still claims
+         * its id to mask the same id in later dirs */
+        if (hidden || (name.empty() && icon.empty()))
+        {
+            keys.emplace(lowercase(id), HIDDEN_ENTRY);
+            return;
+        }
+
+        apps.push_back({name, icon});
+        keys.emplace(lowercase(id), apps.size() - 1);
+        if (!wm_class.empty())
+        {
+            keys.emplace(lowercase(wm_class), apps.size() - 1);
+        }
+    }
+
+    /* The desktop file id joins subdirectories of applications with '-' */
+    void walk_applications(const std::string& path, const std::string& prefix)
+    {
+        DIR *dir = open_dir(path);
+        if (!dir)
+        {
+            return;
+        }
+
+        while (auto ent = readdir(dir))
+        {
+            std::string name = ent->d_name;
+            if ((name == ".") || (name == ".."))
+            {
+                continue;
+            }
+
+            auto child = path + "/" + name;
+            if (is_dir(child, ent))
+            {
+                walk_applications(child, prefix + name + "-");
+            } else if ((name.size() > 8) &&
+                       (name.compare(name.size() - 8, 8, ".desktop") == 0))
+            {
+                parse_desktop_file(child, prefix + name.substr(0, name.size() - 8));
+            }
+        }
+
+        closedir(dir);
+    }
+
+    void walk_icons(const std::string& path, const std::string& rel_dir,
+        int depth, const std::set<std::string>& wanted,
+        std::map<std::string, icon_match>& found)
+    {
+        DIR *dir = open_dir(path);
+        if (!dir)
+        {
+            return;
+        }
+
+        int score = score_icon_dir(rel_dir);
+        while (auto ent = readdir(dir))
+        {
+            std::string name = ent->d_name;
+            if ((name == ".") || (name == ".."))
+            {
+                continue;
+            }
+
+            auto child = path + "/" + name;
+            if (is_dir(child, ent))
+            {
+                if (depth > 0)
+                {
+                    walk_icons(child, rel_dir + "/" + name, depth - 1, wanted, found);
+                }
+
+                continue;
+            }
+
+            auto dot = name.rfind('.');
+            if (dot == std::string::npos)
+            {
+                continue;
+            }
+
+            auto ext = name.substr(dot);
+            if ((ext != ".png") && (ext != ".svg") && (ext != ".xpm"))
+            {
+                continue;
+            }
+
+            auto stem = name.substr(0, dot);
+            if (!wanted.count(stem))
+            {
+                continue;
+            }
+
+            auto it = found.find(stem);
+            if ((it == found.end()) || (score < it->second.score))
+            {
+                found[stem] = {child, score};
+            }
+        }
+
+        closedir(dir);
+    }
+
+    std::vector<std::string> get_theme_inherits(const std::string& theme_dir)
+    {
+        std::ifstream file(theme_dir + "/index.theme");
+        std::vector<std::string> inherits;
+        std::string line;
+
+        while (std::getline(file, line))
+        {
+            if (line.compare(0, 9, "Inherits=") != 0)
+            {
+                continue;
+            }
+
+            size_t start = 9;
+            while (start <= line.size())
+            {
+                auto end = line.find(',', start);
+                if (end == std::string::npos)
+                {
+                    end = line.size();
+                }
+
+                if (end > start)
+                {
+                    inherits.push_back(trim(line.substr(start, end - start)));
+                }
+
+                start = end + 1;
+            }
+
+            break;
+        }
+
+        return inherits;
+    }
+
+    void resolve_icons(const std::vector<std::string>& data_dirs,
+        const std::string& icon_theme)
+    {
+        std::set<std::string> wanted;
+        for (auto& app : apps)
+        {
+            if (!app.icon.empty() && (app.icon[0] != '/'))
+            {
+                wanted.insert(app.icon);
+            }
+        }
+
+        std::vector<std::string> roots = {get_home_dir(".icons")};
+        for (auto& dir : data_dirs)
+        {
+            roots.push_back(dir + "/icons");
+        }
+
+        /* Breadth first through the inheritance chain, hicolor last */
+        std::vector<std::string> themes = {icon_theme};
+        std::set<std::string> seen = {icon_theme, "hicolor"};
+        for (size_t i = 0; i < themes.size(); i++)
+        {
+            std::map<std::string, icon_match> found;
+            bool have_inherits = false;
+
+            for (auto& root : roots)
+            {
+                auto theme_dir = root + "/" + themes[i];
+                if (!have_inherits)
+                {
+                    auto inherits = get_theme_inherits(theme_dir);
+                    have_inherits = !inherits.empty();
+                    for (auto& theme : inherits)
+                    {
+                        if (seen.insert(theme).second)
+                        {
+                            themes.push_back(theme);
+                        }
+                    }
+                }
+
+                walk_icons(theme_dir, "", ICON_THEME_DEPTH, wanted, found);
+            }
+
+            for (auto& match : found)
+            {
+                icons.emplace(match.first, match.second.path);
+            }
+
+            if ((i == themes.size() - 1) && (themes.back() != "hicolor"))
+            {
+                themes.push_back("hicolor");
+            }
+        }
+
+        std::map<std::string, icon_match> found;
+        for (auto& dir : data_dirs)
+        {
+            walk_icons(dir + "/pixmaps", "", 0, wanted, found);
+        }
+
+        for (auto& match : found)
+        {
+            icons.emplace(match.first, match.second.path);
+        }
+    }
+
+    uint32_t add_string(const std::string& str)
+    {
+        auto it = string_offsets.find(str);
+        if (it != string_offsets.end())
+        {
+            return it->second;
+        }
+
+        uint32_t offset = strings.size();
+        strings += str;
+        strings += '\0';
+        string_offsets[str] = offset;
+        return offset;
+    }
+
+  public:
+    std::string build(const std::string& key, const std::string& icon_theme)
+    {
+        auto data_dirs = get_data_dirs();
+        for (auto& dir : data_dirs)
+        {
+            walk_applications(dir + "/applications", "");
+        }
+
+        resolve_icons(data_dirs, icon_theme);
+
+        add_string("");
+        index_header header = {};
+        memcpy(header.magic, INDEX_MAGIC, 4);
+        header.version = INDEX_VERSION;
+        header.key     = add_string(key);
+
+        std::vector<index_dir> dir_table;
+        for (auto& dir : dirs)
+        {
+            dir_table.push_back({add_string(dir.first), 0,
+                (int64_t)dir.second.st_mtim.tv_sec,
+                (int64_t)dir.second.st_mtim.tv_nsec});
+        }
+
+        std::vector<index_entry> entries;
+        for (auto& key : keys)
+        {
+            if (key.second == HIDDEN_ENTRY)
+            {
+                continue;
+            }
+
+            auto& app = apps[key.second];
+            auto icon = app.icon;
+            if (!icon.empty() && (icon[0] != '/'))
+            {
+                auto it = icons.find(icon);
+                icon = (it == icons.end()) ? "" : it->second;
+            }
+
+            entries.push_back({add_string(key.first), hash_key(key.first),
+                add_string(app.name), add_string(icon)});
+        }
+
+        uint32_t n_buckets = 1;
+        while (n_buckets < entries.size() * 2)
+        {
+            n_buckets *= 2;
+        }
+
+        std::vector<uint32_t> buckets(n_buckets, 0);
+        for (uint32_t i = 0; i < entries.size(); i++)
+        {
+            auto b = entries[i].hash & (n_buckets - 1);
+            while (buckets[b])
+            {
+                b = (b + 1) & (n_buckets - 1);
+            }
+
+            buckets[b] = i + 1;
+        }
+
+        header.n_dirs       = dir_table.size();
+        header.dirs         = sizeof(header);
+        header.n_buckets    = n_buckets;
+        header.buckets      = header.dirs + dir_table.size() * sizeof(index_dir);
+        header.n_entries    = entries.size();
+        header.entries      = header.buckets + n_buckets * sizeof(uint32_t);
+        header.strings      = header.entries + entries.size() * sizeof(index_entry);
+        header.strings_size = strings.size();
+
+        std::string data((const char*)&header, sizeof(header));
+        data.append((const char*)dir_table.data(), dir_table.size() * sizeof(index_dir));
+        data.append((const char*)buckets.data(), n_buckets * sizeof(uint32_t));
+        data.append((const char*)entries.data(), entries.size() * sizeof(index_entry));
+        data += strings;
+
+        return data;
+    }
+};
+
+/* Identifies what the index was built for, changing either rebuilds it */
+std::string get_index_key(const std::string& icon_theme)
+{
+    std::string key;
+    for (auto& dir : get_data_dirs())
+    {
+        key += dir + ":";
+    }
+
+    return key + "\n" + icon_theme;
+}
+
+std::string get_index_path(const std::string& icon_theme)
+{
+    auto name = icon_theme;
+    std::replace(name.begin(), name.end(), '/', '_');
+    return get_env_dir("XDG_CACHE_HOME", ".cache") + "/wf-menu/app-index-" + name;
+}
+
+bool write_index(const std::string& path, const std::string& data)
+{
+    auto tmp = path + ".XXXXXX";
+    int fd = mkstemp(&tmp[0]);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    size_t written = 0;
+    while (written < data.size())
+    {
+        auto ret = write(fd, data.data() + written, data.size() - written);
+        if (ret <= 0)
+        {
+            close(fd);
+            unlink(tmp.c_str());
+            return false;
+        }
+
+        written += ret;
+    }
+
+    close(fd);
+    if (rename(tmp.c_str(), path.c_str()))
+    {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+}
+
+AppIndex::~AppIndex()
+{
+    unmap();
+}
+
+void AppIndex::unmap()
+{
+    if (map)
+    {
+        munmap((void*)map, map_size);
+    }
+
+    map = nullptr;
+    map_size = 0;
+}
+
+bool AppIndex::map_file(const std::string& path, const std::string& key)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) || ((size_t)st.st_size < sizeof(index_header)))
+    {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    map = (const char*)data;
+    map_size = st.st_size;
+
+    /* Check the layout once, so lookups only need to bound string offsets */
+    auto header = (const index_header*)map;
+    uint64_t dirs_end    = header->dirs + (uint64_t)header->n_dirs * sizeof(index_dir);
+    uint64_t buckets_end = header->buckets + (uint64_t)header->n_buckets * sizeof(uint32_t);
+    uint64_t entries_end = header->entries + (uint64_t)header->n_entries * sizeof(index_entry);
+    if (memcmp(header->magic, INDEX_MAGIC, 4) || (header->version != INDEX_VERSION) ||
+        (header->dirs % alignof(index_dir)) || (dirs_end > header->buckets) ||
+        (header->buckets % alignof(uint32_t)) || (buckets_end > header->entries) ||
+        (header->entries % alignof(index_entry)) || (entries_end > header->strings) ||
+        (header->n_buckets == 0) || (header->n_buckets & (header->n_buckets - 1)) ||
+        (header->n_buckets <= header->n_entries) || (header->strings_size == 0) ||
+        ((uint64_t)header->strings + header->strings_size != map_size) ||
+        (map[map_size - 1] != '\0') || (header->key >= header->strings_size) ||
+        (key != map + header->strings + header->key))
+    {
+        unmap();
+        return false;
+    }
+
+    return true;
+}
+
+bool AppIndex::is_current() const
+{
+    auto header = (const index_header*)map;
+    auto dirs   = (const index_dir*)(map + header->dirs);
+
+    for (uint32_t i = 0; i < header->n_dirs; i++)
+    {
+        if (dirs[i].path >= header->strings_size)
+        {
+            return false;
+        }
+
+        struct stat st = {};
+        if (stat(map + header->strings + dirs[i].path, &st) || !S_ISDIR(st.st_mode))
+        {
+            st = {};
+        }
+
+        if ((st.st_mtim.tv_sec != dirs[i].mtime_sec) ||
+            (st.st_mtim.tv_nsec != dirs[i].mtime_nsec))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AppIndex::open(const std::string& icon_theme)
+{
+    unmap();
+    if (map_file(get_index_path(icon_theme), get_index_key(icon_theme)) &&
+        is_current())
+    {
+        return true;
+    }
+
+    unmap();
+    return false;
+}
+
+bool AppIndex::build(const std::string& icon_theme)
+{
+    auto path = get_index_path(icon_theme);
+    auto dir  = path.substr(0, path.rfind('/'));
+    mkdir(dir.substr(0, dir.rfind('/')).c_str(), 0700);
+    mkdir(dir.c_str(), 0700);
+
+    /* Several menus may find the index stale at once, one build is enough */
+    int lock = ::open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lock < 0)
+    {
+        return false;
+    }
+
+    if (flock(lock, LOCK_EX | LOCK_NB))
+    {
+        close(lock);
+        return errno == EWOULDBLOCK;
+    }
+
+    auto data = index_builder().build(get_index_key(icon_theme), icon_theme);
+    bool ret  = write_index(path, data);
+    close(lock);
+
+    return ret;
+}
+
+bool AppIndex::lookup(const std::string& app_id, AppInfo& info) const
+{
+    if (!map)
+    {
+        return false;
+    }
+
+    auto header  = (const index_header*)map;
+    auto buckets = (const uint32_t*)(map + header->buckets);
+    auto entries = (const index_entry*)(map + header->entries);
+    auto strings = map + header->strings;
+    auto key     = lowercase(app_id);
+    auto hash    = hash_key(key);
+
+    for (uint32_t b = hash & (header->n_buckets - 1), n = 0;
+         buckets[b] && (n < header->n_buckets);
+         b = (b + 1) & (header->n_buckets - 1), n++)
+    {
+        if (buckets[b] > header->n_entries)
+        {
+            return false;
+        }
+
+        auto& entry = entries[buckets[b] - 1];
+        if ((entry.hash != hash) || (entry.key >= header->strings_size) ||
+            (entry.name >= header->strings_size) ||
+            (entry.icon >= header->strings_size) ||
+            (key != strings + entry.key))
+        {
+            continue;
+        }
+
+        info.name = strings + entry.name;
+        info.icon = strings + entry.icon;
+        return true;
+    }
+
+    return false;
+}
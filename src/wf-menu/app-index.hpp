@@ -0,0 +1,68 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Scott Moreau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+struct AppInfo
+{
+    /* Point into the mapped index, valid while the index is open */
+    const char *name;
+    const char *icon;
+};
+
+/* Cached index of desktop entries and their icons.
+ *
+ * The index is built once by walking the XDG data dirs and icon themes and
+ * stored under $XDG_CACHE_HOME/wf-menu. It records the mtime of every
+ * directory it walked, so checking it is current only needs a stat of each
+ * of those instead of a scan. Building is kept out of the menu process,
+ * see wf-menu --build-index. Entries are keyed by lowercase desktop file
+ * id and StartupWMClass in an open addressed hash table that is used
+ * directly from the mapped file. */
+class AppIndex
+{
+  public:
+    AppIndex() = default;
+    AppIndex(const AppIndex&) = delete;
+    AppIndex& operator =(const AppIndex&) = delete;
+    ~AppIndex();
+
+    /* Map the index for the given icon theme, fails if missing or stale */
+    bool open(const std::string& icon_theme);
+    /* Walk the data dirs and icon themes and write the index */
+    static bool build(const std::string& icon_theme);
+    bool lookup(const std::string& app_id, AppInfo& info) const;
+
+  private:
+    const char *map = nullptr;
+    size_t map_size = 0;
+    bool map_file(const std::string& path, const std::string& key);
+    bool is_current() const;
+    void unmap();
+};
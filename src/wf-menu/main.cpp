@@ -24,6 +24,10 @@
 
 
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <gdk/wayland/gdkwayland.h>
 
 #include "menu.hpp"
@@ -49,6 +53,84 @@ void WfMenu::on_menu_item_close()
     exit(0);
 }
 
+void WfMenu::on_menu_item_move_to_workspace(const Glib::VariantBase& parameter)
+{
+    auto index = Glib::VariantBase::cast_dynamic<Glib::Variant<int>>(parameter).get();
+    int columns = 1;
+
+    for (auto& output : outputs)
+    {
+        if (output.name == view_output)
+        {
+            columns = std::max(output.columns, 1);
+        }
+    }
+
+    wf_desktop_base_move_to_workspace(wf_desktop_manager,
+        index % columns, index / columns);
+    wl_display_flush(display);
+    exit(0);
+}
+
+void WfMenu::on_menu_item_move_to_output(const Glib::VariantBase& parameter)
+{
+    auto name = Glib::VariantBase::cast_dynamic<Glib::Variant<Glib::ustring>>(parameter).get();
+
+    wf_desktop_base_move_to_output(wf_desktop_manager, name.c_str());
+    wl_display_flush(display);
+    exit(0);
+}
+
+/* Rebuilt from the layout snapshot, and again on output hotplug */
+void WfMenu::update_move_menu()
+{
+    if (!move_section)
+    {
+        return;
+    }
+
+    move_section->remove_all();
+
+    auto workspace_menu = Gio::Menu::create();
+    auto output_menu    = Gio::Menu::create();
+    for (auto& output : outputs)
+    {
+        if (output.name != view_output)
+        {
+            output_menu->append(output.name,
+                Gio::Action::print_detailed_name_variant("example.move-to-output",
+                Glib::Variant<Glib::ustring>::create(output.name)));
+            continue;
+        }
+
+        for (int y = 0; y < output.rows; y++)
+        {
+            for (int x = 0; x < output.columns; x++)
+            {
+                if ((x == view_ws_x) && (y == view_ws_y))
+                {
+                    continue;
+                }
+
+                int index = y * output.columns + x;
+                workspace_menu->append("Workspace " + std::to_string(index + 1),
+                    Gio::Action::print_detailed_name_variant("example.move-to-workspace",
+                    Glib::Variant<int>::create(index)));
+            }
+        }
+    }
+
+    if (workspace_menu->get_n_items())
+    {
+        move_section->append_submenu("Move to _Workspace", workspace_menu);
+    }
+
+    if (output_menu->get_n_items())
+    {
+        move_section->append_submenu("Move to _Output", output_menu);
+    }
+}
+
 bool WfMenu::on_key_press(guint keyval, guint keycode, Gdk::ModifierType state)
 {
     popover_menu.popup();
@@ -65,6 +147,30 @@ void WfMenu::on_startup()
 {
     app->add_window(*this);
 
+    auto icon_theme =
+        Gtk::Settings::get_default()->property_gtk_icon_theme_name().get_value();
+    if (!app_index.open(icon_theme))
+    {
+        /* Never scan at menu time, build in the background and go
+         * without names and icons until the next spawn */
+        try
+        {
+            Glib::spawn_async("", std::vector<std::string>{
+                "/proc/self/exe", "--build-index", icon_theme});
+        }
+        catch (const Glib::SpawnError& ex)
+        {
+            std::cerr << "Failed to spawn index builder: " << ex.what() << std::endl;
+        }
+    }
+
+    if (switcher)
+    {
+        build_switcher();
+        show();
+        return;
+    }
+
     ref_event = Gtk::EventControllerKey::create();
     ref_event->signal_key_pressed().connect(
         sigc::mem_fun(*this, &WfMenu::on_key_press), false);
@@ -80,6 +186,14 @@ void WfMenu::on_startup()
     
     ref_action_group->add_action("close",
       sigc::mem_fun(*this, &WfMenu::on_menu_item_close));
+
+    ref_action_group->add_action_with_parameter("move-to-workspace",
+      Glib::VARIANT_TYPE_INT32,
+      sigc::mem_fun(*this, &WfMenu::on_menu_item_move_to_workspace));
+
+    ref_action_group->add_action_with_parameter("move-to-output",
+      Glib::VARIANT_TYPE_STRING,
+      sigc::mem_fun(*this, &WfMenu::on_menu_item_move_to_output));
     
     insert_action_group("example", ref_action_group);
 
@@ -88,7 +202,14 @@ void WfMenu::on_startup()
     Glib::ustring ui_info =
       "<interface>"
     "  <menu id='menubar'>"
-    "    <section>"
+    "    <section>";
+    AppInfo info;
+    if (app_index.lookup(app_id, info) && *info.name)
+    {
+      ui_info +=
+      "      <attribute name='label'>" + Glib::Markup::escape_text(info.name) + "</attribute>";
+    }
+    ui_info +=
     "      <item>";
     ui_info += maximized ?
     "        <attribute name='label' translatable='yes'>_Unmaximize</attribute>" :
@@ -127,6 +248,13 @@ void WfMenu::on_startup()
     if(!gmenu)
       g_warning("GMenu not found");
 
+    if (gmenu && !outputs.empty())
+    {
+      move_section = Gio::Menu::create();
+      gmenu->append_section(move_section);
+      update_move_menu();
+    }
+
     const std::string style_info = "* {border-radius: 0;}";
     auto style_context = this->get_style_context();
     css_provider = Gtk::CssProvider::create();
@@ -156,8 +284,8 @@ static void registry_add(void *data, struct wl_registry *registry,
     if (strcmp(interface, wf_desktop_base_interface.name) == 0)
     {
         wfm->wf_desktop_manager = (wf_desktop_base *)
-            wl_registry_bind(registry, id,
-            &wf_desktop_base_interface, 1);
+            wl_registry_bind(registry, id, &wf_desktop_base_interface,
+            std::min(version, (uint32_t) wf_desktop_base_interface.version));
     }
 }
 
@@ -178,31 +306,150 @@ static void view_actions(void *data,
 {
     WfMenu *wfm = (WfMenu *) data;
 
+    /* Fields after Title start on their own line, anchor on the newline
+     * so that a title cannot fake them */
     std::string str(actions);
-    auto pos = str.find("Maximized:") + strlen("Maximized:");
-    if (str[pos] == '1')
+    auto get_field = [&str] (const std::string& key)
     {
-        wfm->maximized = true;
-    } else
+        auto pos = str.find("\n" + key + ":");
+        if (pos == std::string::npos)
+        {
+            return std::string();
+        }
+
+        pos += key.size() + 2;
+        return str.substr(pos, str.find('\n', pos) - pos);
+    };
+
+    wfm->app_id = get_field("AppId");
+    wfm->maximized = (get_field("Maximized") == "1");
+    wfm->minimized = (get_field("Minimized") == "1");
+}
+
+static void view_list(void *data,
+    struct wf_desktop_base *wf_desktop_base,
+    int32_t fd, uint32_t size)
+{
+    WfMenu *wfm = (WfMenu *) data;
+
+    if (size == 0)
     {
-        wfm->maximized = false;
+        close(fd);
+        return;
     }
-    pos = str.find("Minimized:") + strlen("Minimized:");
-    if (str[pos] == '1')
+
+    auto map = (char *) mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
     {
-        wfm->minimized = true;
-    } else
+        std::cerr << "Failed to map view list." << std::endl;
+        return;
+    }
+
+    std::istringstream stream(std::string(map, size));
+    munmap(map, size);
+
+    std::string line;
+    while (std::getline(stream, line))
     {
-        wfm->minimized = false;
+        std::istringstream fields(line);
+        std::string id, ws_x, ws_y;
+        SwitcherEntry entry;
+
+        std::getline(fields, id, '\t');
+        std::getline(fields, ws_x, '\t');
+        std::getline(fields, ws_y, '\t');
+        std::getline(fields, entry.output, '\t');
+        std::getline(fields, entry.app_id, '\t');
+        std::getline(fields, entry.title);
+        entry.id = strtoul(id.c_str(), nullptr, 10);
+        entry.ws_x = strtol(ws_x.c_str(), nullptr, 10);
+        entry.ws_y = strtol(ws_y.c_str(), nullptr, 10);
+        wfm->views.push_back(entry);
     }
 }
 
+static void layout(void *data,
+    struct wf_desktop_base *wf_desktop_base,
+    const char *layout)
+{
+    WfMenu *wfm = (WfMenu *) data;
+
+    std::istringstream stream(layout);
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        /* View:x,y:name and Output:columns,rows:name */
+        auto colon = line.find(':');
+        auto comma = line.find(',', colon);
+        auto name  = line.find(':', comma);
+        if ((colon == std::string::npos) || (comma == std::string::npos) ||
+            (name == std::string::npos))
+        {
+            continue;
+        }
+
+        auto key = line.substr(0, colon);
+        int a = strtol(line.c_str() + colon + 1, nullptr, 10);
+        int b = strtol(line.c_str() + comma + 1, nullptr, 10);
+        if (key == "View")
+        {
+            wfm->view_ws_x = a;
+            wfm->view_ws_y = b;
+            wfm->view_output = line.substr(name + 1);
+        } else if (key == "Output")
+        {
+            wfm->outputs.push_back({line.substr(name + 1), a, b});
+        }
+    }
+}
+
+static void output_added(void *data,
+    struct wf_desktop_base *wf_desktop_base,
+    const char *output, int32_t columns, int32_t rows)
+{
+    WfMenu *wfm = (WfMenu *) data;
+
+    wfm->outputs.push_back({output, columns, rows});
+    wfm->update_move_menu();
+}
+
+static void output_removed(void *data,
+    struct wf_desktop_base *wf_desktop_base,
+    const char *output)
+{
+    WfMenu *wfm = (WfMenu *) data;
+
+    auto& outputs = wfm->outputs;
+    outputs.erase(std::remove_if(outputs.begin(), outputs.end(),
+        [=] (const OutputInfo& o) { return o.name == output; }), outputs.end());
+    wfm->update_move_menu();
+}
+
+static void view_workspace(void *data,
+    struct wf_desktop_base *wf_desktop_base,
+    const char *output, int32_t x, int32_t y)
+{
+    WfMenu *wfm = (WfMenu *) data;
+
+    wfm->view_output = output;
+    wfm->view_ws_x = x;
+    wfm->view_ws_y = y;
+    wfm->update_move_menu();
+}
+
 static struct wf_desktop_base_listener desktop_base_listener {
 	.view_actions = view_actions,
+	.view_list = view_list,
+	.layout = layout,
+	.output_added = output_added,
+	.output_removed = output_removed,
+	.view_workspace = view_workspace,
 };
 
-WfMenu::WfMenu(const Glib::RefPtr<Gtk::Application>& app)
+WfMenu::WfMenu(const Glib::RefPtr<Gtk::Application>& app, bool switcher)
 {
+    this->switcher = switcher;
     display = gdk_wayland_display_get_wl_display(gdk_display_get_default());
     if (!display)
     {
@@ -228,6 +475,17 @@ WfMenu::WfMenu(const Glib::RefPtr<Gtk::Application>& app)
     maximized = minimized = false;
     wf_desktop_base_add_listener(wf_desktop_manager,
         &desktop_base_listener, this);
+    if (switcher)
+    {
+        if (wf_desktop_base_get_version(wf_desktop_manager) <
+            WF_DESKTOP_BASE_LIST_VIEWS_SINCE_VERSION)
+        {
+            std::cout << "Compositor does not support the window switcher." << std::endl;
+            return;
+        }
+
+        wf_desktop_base_list_views(wf_desktop_manager);
+    }
     wl_display_roundtrip(display);
 
     this->app = app;
@@ -244,9 +502,45 @@ WfMenu::~WfMenu()
 
 int main(int argc, char *argv[])
 {
+    /* wf-menu --build-index [icon-theme], e.g. run at session start */
+    if ((argc > 1) && (std::string(argv[1]) == "--build-index"))
+    {
+        std::string icon_theme = "hicolor";
+        if (argc > 2)
+        {
+            icon_theme = argv[2];
+        } else if (gtk_init_check())
+        {
+            char *name = nullptr;
+            g_object_get(gtk_settings_get_default(), "gtk-icon-theme-name", &name, nullptr);
+            if (name)
+            {
+                icon_theme = name;
+                g_free(name);
+            }
+        }
+
+        return AppIndex::build(icon_theme) ? 0 : 1;
+    }
+
     auto app = Gtk::Application::create("wf-menu");
+    bool switcher = false;
+
+    /* Strip our own options before gtk sees them */
+    int n = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--switcher")
+        {
+            switcher = true;
+            continue;
+        }
+
+        argv[n++] = argv[i];
+    }
+    argc = n;
 
-    WfMenu window(app);
+    WfMenu window(app, switcher);
 
     return app->run(argc, argv);
 }
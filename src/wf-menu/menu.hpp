@@ -27,12 +27,27 @@
 
 #include <gtkmm.h>
 
+#include "app-index.hpp"
+#include "title-filter.hpp"
 #include "wayfire-desktop-client-protocol.h"
 
+struct OutputInfo
+{
+    std::string name;
+    int columns, rows;
+};
+
+struct SwitcherEntry
+{
+    uint32_t id;
+    int ws_x, ws_y;
+    std::string output, app_id, title;
+};
+
 class WfMenu : public Gtk::Window
 {
   public:
-    WfMenu(const Glib::RefPtr<Gtk::Application>& app);
+    WfMenu(const Glib::RefPtr<Gtk::Application>& app, bool switcher);
     virtual ~WfMenu();
 
     wl_display *display;
@@ -40,16 +55,43 @@ class WfMenu : public Gtk::Window
     Glib::RefPtr<Gtk::Application> app;
     Gtk::PopoverMenu popover_menu;
     bool maximized, minimized;
+    bool switcher;
+    std::string app_id;
+    std::vector<SwitcherEntry> views;
+    std::vector<OutputInfo> outputs;
+    std::string view_output;
+    int view_ws_x = 0, view_ws_y = 0;
+    void update_move_menu();
     void on_startup();
   protected:
     Gtk::Box box;
     Glib::RefPtr<Gtk::Builder> ref_builder;
     Glib::RefPtr<Gtk::EventControllerKey> ref_event;
     Glib::RefPtr<Gtk::CssProvider> css_provider;
+    AppIndex app_index;
     bool on_key_press(guint keyval, guint keycode, Gdk::ModifierType state);
     void on_menu_item_maximize();
     void on_menu_item_minimize();
     void on_menu_item_close();
+    void on_menu_item_move_to_workspace(const Glib::VariantBase& parameter);
+    void on_menu_item_move_to_output(const Glib::VariantBase& parameter);
+    Glib::RefPtr<Gio::Menu> move_section;
     void on_right_click(int n_press, double x, double y);
     void on_popover_hide();
+
+    /* Switcher mode */
+    Gtk::Box switcher_box;
+    Gtk::SearchEntry search_entry;
+    Gtk::ScrolledWindow scrolled_window;
+    Gtk::ListBox list_box;
+    TitleFilter title_filter;
+    std::vector<bool> visible;
+    void build_switcher();
+    bool on_switcher_key_press(guint keyval, guint keycode, Gdk::ModifierType state);
+    void on_search_changed();
+    void on_search_activate();
+    void on_row_activated(Gtk::ListBoxRow *row);
+    bool on_filter_row(Gtk::ListBoxRow *row);
+    void on_update_header(Gtk::ListBoxRow *row, Gtk::ListBoxRow *before);
+    void select_row(int step);
 };
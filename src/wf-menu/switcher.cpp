@@ -0,0 +1,195 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Scott Moreau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "menu.hpp"
+
+void WfMenu::build_switcher()
+{
+    std::vector<std::string> titles;
+    for (auto& view : views)
+    {
+        titles.push_back(Glib::ustring(view.title).casefold().raw());
+
+        auto image = Gtk::make_managed<Gtk::Image>();
+        AppInfo info;
+        if (app_index.lookup(view.app_id, info) && *info.icon)
+        {
+            image->set(Gio::FileIcon::create(Gio::File::create_for_path(info.icon)));
+        } else
+        {
+            image->set_from_icon_name("application-x-executable");
+        }
+        image->set_pixel_size(24);
+
+        auto label = Gtk::make_managed<Gtk::Label>(view.title);
+        label->set_halign(Gtk::Align::START);
+        label->set_ellipsize(Pango::EllipsizeMode::END);
+
+        auto row_box = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::HORIZONTAL, 6);
+        row_box->append(*image);
+        row_box->append(*label);
+        list_box.append(*row_box);
+    }
+
+    title_filter.set_titles(titles);
+    visible.assign(views.size(), true);
+
+    ref_event = Gtk::EventControllerKey::create();
+    ref_event->set_propagation_phase(Gtk::PropagationPhase::CAPTURE);
+    ref_event->signal_key_pressed().connect(
+        sigc::mem_fun(*this, &WfMenu::on_switcher_key_press), false);
+    this->add_controller(ref_event);
+
+    list_box.set_filter_func(sigc::mem_fun(*this, &WfMenu::on_filter_row));
+    list_box.set_header_func(sigc::mem_fun(*this, &WfMenu::on_update_header));
+    list_box.signal_row_activated().connect(
+        sigc::mem_fun(*this, &WfMenu::on_row_activated));
+    search_entry.signal_changed().connect(
+        sigc::mem_fun(*this, &WfMenu::on_search_changed));
+    search_entry.signal_activate().connect(
+        sigc::mem_fun(*this, &WfMenu::on_search_activate));
+
+    scrolled_window.set_policy(Gtk::PolicyType::NEVER, Gtk::PolicyType::AUTOMATIC);
+    scrolled_window.set_vexpand(true);
+    scrolled_window.set_child(list_box);
+    switcher_box.set_orientation(Gtk::Orientation::VERTICAL);
+    switcher_box.append(search_entry);
+    switcher_box.append(scrolled_window);
+    set_child(switcher_box);
+    set_default_size(600, 400);
+
+    select_row(1);
+    search_entry.grab_focus();
+}
+
+bool WfMenu::on_switcher_key_press(guint keyval, guint keycode, Gdk::ModifierType state)
+{
+    switch (keyval)
+    {
+      case GDK_KEY_Escape:
+        exit(0);
+
+      case GDK_KEY_Down:
+        select_row(1);
+        return true;
+
+      case GDK_KEY_Up:
+        select_row(-1);
+        return true;
+
+      default:
+        return false;
+    }
+}
+
+void WfMenu::on_search_changed()
+{
+    auto query = search_entry.get_text().casefold().raw();
+
+    visible.assign(views.size(), false);
+    for (auto i : title_filter.update(query))
+    {
+        visible[i] = true;
+    }
+
+    list_box.invalidate_filter();
+    list_box.unselect_all();
+    select_row(1);
+}
+
+void WfMenu::on_search_activate()
+{
+    auto row = list_box.get_selected_row();
+    if (row)
+    {
+        on_row_activated(row);
+    }
+}
+
+void WfMenu::on_row_activated(Gtk::ListBoxRow *row)
+{
+    wf_desktop_base_activate_view(wf_desktop_manager, views[row->get_index()].id);
+    wl_display_flush(display);
+    exit(0);
+}
+
+bool WfMenu::on_filter_row(Gtk::ListBoxRow *row)
+{
+    return visible[row->get_index()];
+}
+
+void WfMenu::on_update_header(Gtk::ListBoxRow *row, Gtk::ListBoxRow *before)
+{
+    auto& view = views[row->get_index()];
+
+    if (before)
+    {
+        auto& prev = views[before->get_index()];
+        if ((prev.output == view.output) &&
+            (prev.ws_x == view.ws_x) && (prev.ws_y == view.ws_y))
+        {
+            row->unset_header();
+            return;
+        }
+    }
+
+    auto label = Gtk::make_managed<Gtk::Label>(view.output + " - Workspace " +
+        std::to_string(view.ws_x + 1) + "," + std::to_string(view.ws_y + 1));
+    label->set_halign(Gtk::Align::START);
+    label->add_css_class("dim-label");
+    row->set_header(*label);
+}
+
+/* Move the selection to the next visible row in the given direction,
+ * or to the first visible row if nothing visible is selected */
+void WfMenu::select_row(int step)
+{
+    auto selected = list_box.get_selected_row();
+    int i = -1;
+
+    if (selected && visible[selected->get_index()])
+    {
+        i = selected->get_index();
+    } else
+    {
+        step = 1;
+    }
+
+    for (i += step; (i >= 0) && (i < (int) views.size()); i += step)
+    {
+        if (!visible[i])
+        {
+            continue;
+        }
+
+        auto row = list_box.get_row_at_index(i);
+        list_box.select_row(*row);
+
+        auto allocation = row->get_allocation();
+        scrolled_window.get_vadjustment()->clamp_page(allocation.get_y(),
+            allocation.get_y() + allocation.get_height());
+        return;
+    }
+}
@@ -0,0 +1,84 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Scott Moreau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <chrono>
+#include <random>
+#include <iostream>
+
+#include "title-filter.hpp"
+
+#define TITLE_COUNT 10000
+#define ROUNDS 20
+
+/* Times TitleFilter::update() typing a query one character at a time over
+ * generated browser and terminal style titles, as the switcher does */
+int main()
+{
+    const char *words[] = {
+        "mozilla", "firefox", "terminal", "bash", "github", "pull", "request",
+        "wayfire", "emacs", "~/src/project", "youtube", "documentation",
+    };
+    const size_t n_words = sizeof(words) / sizeof(words[0]);
+    std::mt19937 rng(1);
+
+    std::vector<std::string> titles;
+    for (int i = 0; i < TITLE_COUNT; i++)
+    {
+        std::string title;
+        for (int w = 0; w < 10; w++)
+        {
+            title += std::string(words[rng() % n_words]) + " - ";
+        }
+
+        titles.push_back(title);
+    }
+
+    const std::string query = "wayfire term";
+    TitleFilter filter;
+    size_t matches = 0;
+    double total  = 0;
+
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        filter.set_titles(titles);
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 1; i <= query.size(); i++)
+        {
+            matches += filter.update(query.substr(0, i)).size();
+        }
+
+        total += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    /* One round types the whole query, matches add up over all prefixes */
+    std::cout << TITLE_COUNT << " titles: " << total / ROUNDS << " ms per " <<
+        query.size() << " keystrokes, " << total / ROUNDS / query.size() <<
+        " ms per keystroke (" << matches / ROUNDS << " matches summed over " <<
+        query.size() << " keystrokes)" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Scott Moreau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <cstring>
+
+#include "title-filter.hpp"
+
+void TitleFilter::set_titles(const std::vector<std::string>& titles)
+{
+    haystack.clear();
+    offsets.clear();
+    for (auto& title : titles)
+    {
+        offsets.push_back(haystack.size());
+        haystack += title;
+    }
+
+    offsets.push_back(haystack.size());
+
+    results.resize(titles.size());
+    for (uint32_t i = 0; i < titles.size(); i++)
+    {
+        results[i] = i;
+    }
+
+    last_query.clear();
+}
+
+bool TitleFilter::matches(const char *title, size_t title_len,
+    const std::string& query)
+{
+    if (query.empty())
+    {
+        return true;
+    }
+
+    if (query.size() > title_len)
+    {
+        return false;
+    }
+
+    /* memmem and memchr are SIMD accelerated in libc, which does the
+     * heavy lifting for both the substring and the in-order match */
+    if (memmem(title, title_len, query.data(), query.size()))
+    {
+        return true;
+    }
+
+    const char *pos = title;
+    const char *end = title + title_len;
+    for (char c : query)
+    {
+        pos = (const char*)memchr(pos, c, end - pos);
+        if (!pos)
+        {
+            return false;
+        }
+
+        pos++;
+    }
+
+    return true;
+}
+
+const std::vector<uint32_t>& TitleFilter::update(const std::string& query)
+{
+    /* Narrowing the query can only drop matches, so start over from all
+     * titles only when it no longer extends the previous one */
+    if (query.compare(0, last_query.size(), last_query) != 0)
+    {
+        results.resize(offsets.size() - 1);
+        for (uint32_t i = 0; i < results.size(); i++)
+        {
+            results[i] = i;
+        }
+    }
+
+    scratch.clear();
+    for (auto i : results)
+    {
+        if (matches(haystack.data() + offsets[i],
+            offsets[i + 1] - offsets[i], query))
+        {
+            scratch.push_back(i);
+        }
+    }
+
+    results.swap(scratch);
+    last_query = query;
+
+    return results;
+}
@@ -0,0 +1,54 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Scott Moreau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/* Incremental type-ahead matcher for window titles.
+ *
+ * Titles and queries are expected to be case folded by the caller. A title
+ * matches if it contains the query as a substring, or failing that, if the
+ * query characters appear in the title in order. Either way, a title that
+ * matches a query also matches every prefix of it, so when the query grows
+ * only the previous matches are searched again. */
+class TitleFilter
+{
+  public:
+    void set_titles(const std::vector<std::string>& titles);
+    const std::vector<uint32_t>& update(const std::string& query);
+    static bool matches(const char *title, size_t title_len,
+        const std::string& query);
+
+  private:
+    /* All titles back to back, so a scan walks one contiguous buffer */
+    std::string haystack;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> results;
+    std::vector<uint32_t> scratch;
+    std::string last_query;
+};